@@ -0,0 +1,134 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstring>
+#include <map>
+#include "dictionary.h"
+
+using namespace std;
+
+const char dictionarySignature[] = { 'K', 'D', 'i', 'c', 't', '!' };
+const int dictionarySignatureLength = sizeof(dictionarySignature);
+
+static map<uint32_t, HuffmanTables> dictionaryCache; // built tables, reused for every file and archive
+static map<string, uint32_t> loadedDictionaryNames; // file name -> id of files already read and checked
+
+// FNV-1a over the table, so the same corpus always gives the same id
+static uint32_t hashFrequencyTable(const vector<uint64_t>& byteFrequency)
+{
+	uint32_t hash = 2166136261u;
+	for (const auto& freq : byteFrequency)
+	{
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&freq);
+		for (size_t i = 0; i < sizeof(freq); i++)
+		{
+			hash ^= bytes[i];
+			hash *= 16777619u;
+		}
+	}
+	return hash;
+}
+
+uint32_t trainDictionary(const vector<string>& sampleFileNames, vector<uint64_t>& byteFrequency)
+{
+	byteFrequency.assign(256, 0);
+	for (const auto& fileName : sampleFileNames)
+	{
+		countByteFrequency(fileName, byteFrequency);
+	}
+
+	for (auto& freq : byteFrequency)
+	{
+		freq++;
+	}
+
+	return hashFrequencyTable(byteFrequency);
+}
+
+string dictionaryFileName(uint32_t id)
+{
+	ostringstream name;
+	name << "dictionary_" << hex << setw(8) << setfill('0') << id << ".kdict";
+	return name.str();
+}
+
+bool saveDictionary(const string& outputFileName, uint32_t id, const vector<uint64_t>& byteFrequency)
+{
+	ofstream outputFile(outputFileName, ios::binary);
+	if (!outputFile)
+	{
+		cerr << "Failed to open dictionary file for writing: " << outputFileName << endl;
+		return false;
+	}
+
+	outputFile.write(dictionarySignature, dictionarySignatureLength);
+	outputFile.write(reinterpret_cast<const char*>(&id), sizeof(id));
+	outputFile.close();
+
+	writeFrequencyTable(outputFileName, byteFrequency);
+	return true;
+}
+
+const HuffmanTables* loadDictionary(const string& inputFileName, uint32_t& id)
+{
+	auto loaded = loadedDictionaryNames.find(inputFileName);
+	if (loaded != loadedDictionaryNames.end())
+	{
+		id = loaded->second;
+		return &dictionaryCache[id];
+	}
+
+	ifstream inputFile(inputFileName, ios::binary);
+	if (!inputFile)
+	{
+		cerr << "Failed to open dictionary file: " << inputFileName << endl;
+		return nullptr;
+	}
+
+	char signatureBuffer[dictionarySignatureLength];
+	inputFile.read(signatureBuffer, dictionarySignatureLength);
+	inputFile.read(reinterpret_cast<char*>(&id), sizeof(id));
+
+	if (!inputFile || memcmp(signatureBuffer, dictionarySignature, dictionarySignatureLength) != 0)
+	{
+		cerr << "Invalid dictionary file: " << inputFileName << endl;
+		return nullptr;
+	}
+	inputFile.close();
+
+	// the id is the hash of the table, so a damaged or edited file cannot pass for another dictionary
+	vector<uint64_t> byteFrequency;
+	readFrequencyTable(inputFileName, byteFrequency, DICTIONARY_HEADER_LENGTH);
+	if (hashFrequencyTable(byteFrequency) != id)
+	{
+		cerr << "Dictionary file " << inputFileName << " is damaged: its table does not match its id." << endl;
+		return nullptr;
+	}
+
+	loadedDictionaryNames[inputFileName] = id;
+
+	auto it = dictionaryCache.find(id);
+	if (it != dictionaryCache.end())
+		return &it->second;
+
+	HuffmanTables& tables = dictionaryCache[id];
+	buildHuffmanTables(byteFrequency, tables);
+	return &tables;
+}
+
+const HuffmanTables* findDictionary(uint32_t id)
+{
+	auto it = dictionaryCache.find(id);
+	if (it != dictionaryCache.end())
+		return &it->second;
+
+	uint32_t loadedId;
+	const HuffmanTables* tables = loadDictionary(dictionaryFileName(id), loadedId);
+	if (tables && loadedId != id)
+	{
+		cerr << "Dictionary file " << dictionaryFileName(id) << " has a different id." << endl;
+		return nullptr;
+	}
+	return tables;
+}
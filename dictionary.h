@@ -0,0 +1,28 @@
+#ifndef DICTIONARY_H
+#define DICTIONARY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "huffman.h"
+
+// Shared dictionary file: signature, id, then 256 frequencies (like the table in an archive).
+// Archives made with a dictionary store only its id instead of the 2048-byte table.
+
+#define DICTIONARY_HEADER_LENGTH 10 // signature + id
+
+// counts frequencies over the sample files; every byte gets at least 1 so any input can be coded
+// returns the dictionary id (a hash of the table)
+uint32_t trainDictionary(const std::vector<std::string>& sampleFileNames, std::vector<uint64_t>& byteFrequency);
+
+std::string dictionaryFileName(uint32_t id);
+
+bool saveDictionary(const std::string& outputFileName, uint32_t id, const std::vector<uint64_t>& byteFrequency);
+
+// loads a dictionary file and caches its tables, nullptr on error
+const HuffmanTables* loadDictionary(const std::string& inputFileName, uint32_t& id);
+
+// returns cached tables, on a miss loads dictionaryFileName(id), nullptr if it is not found
+const HuffmanTables* findDictionary(uint32_t id);
+
+#endif
@@ -3,7 +3,12 @@
 #include <queue>
 #include <bitset>
 #include <stdio.h> 
+#include <cmath>
+#include <numeric>
+#include <algorithm>
 #include "huffman.h"
+#include "metrics.h"
+#include "writer.h"
 #define WHERESTART 2048
 
 using namespace std;
@@ -13,7 +18,7 @@ void generateCodes(Node* root, string str, unordered_map<uint8_t, string>& huffm
 	if (!root) return;
 	if (root->left == nullptr && root->right == nullptr)
 	{
-		huffmanCodes[root->byte] = str;
+		huffmanCodes[root->byte] = str.empty() ? "0" : str; // a single-symbol tree still needs one bit per byte
 	}
 
 	generateCodes(root->left, str + "0", huffmanCodes);
@@ -22,6 +27,7 @@ void generateCodes(Node* root, string str, unordered_map<uint8_t, string>& huffm
 
 Node* buildHuffmanTree(const vector<uint64_t>& byteFrequency)
 {
+	METRICS_TIMER(PHASE_BUILD_TREE);
 	priority_queue<Node*, vector<Node*>, Compare> minHeap;
 
 	for (int i = 0; i < 256; i++)
@@ -42,11 +48,31 @@ Node* buildHuffmanTree(const vector<uint64_t>& byteFrequency)
 		minHeap.push(newNode);
 	}
 
+	if (minHeap.empty()) // only empty files
+		return nullptr;
+
 	return minHeap.top();
 }
 
+void buildHuffmanTables(const vector<uint64_t>& byteFrequency, HuffmanTables& tables)
+{
+	tables.byteFrequency = byteFrequency;
+	tables.huffmanCodes.clear();
+	tables.reverseHuffmanCodes.clear();
+
+	Node* root = buildHuffmanTree(byteFrequency);
+	generateCodes(root, "", tables.huffmanCodes);
+	delete root;
+
+	for (const auto& pair : tables.huffmanCodes)
+	{
+		tables.reverseHuffmanCodes[pair.second] = pair.first;
+	}
+}
+
 void countByteFrequency(const string& inputFileName, vector<uint64_t>& byteFrequency)
 {
+	METRICS_TIMER(PHASE_COUNT_FREQUENCY);
 	ifstream inputFile(inputFileName, ios::binary);
 	if (!inputFile)
 	{
@@ -55,14 +81,85 @@ void countByteFrequency(const string& inputFileName, vector<uint64_t>& byteFrequ
 	}
 
 	char byte;
+	uint64_t bytesRead = 0;
 	while (inputFile.get(byte))
 	{
 		byteFrequency[static_cast<unsigned char>(byte)]++;
+		bytesRead++;
+		METRICS_TICK(bytesRead);
 	}
+	METRICS_BYTES(PHASE_COUNT_FREQUENCY, bytesRead, 0);
 
 	inputFile.close();
 }
 
+// estimated size in bits of data with frequencies "data" coded with a table built from "table"
+static double codedSizeBits(const vector<uint64_t>& data, const vector<uint64_t>& table)
+{
+	double total = static_cast<double>(accumulate(table.begin(), table.end(), uint64_t(0)));
+	double bits = 0;
+	for (int i = 0; i < 256; i++)
+	{
+		if (data[i] > 0)
+			bits += data[i] * -log2(table[i] / total);
+	}
+	return bits;
+}
+
+vector<uint8_t> groupFilesByFrequency(const vector<vector<uint64_t>>& fileFrequency, int maxGroups, vector<vector<uint64_t>>& groupFrequency)
+{
+	const double tableBits = 256 * 8 * 8;
+
+	vector<uint8_t> fileGroup(fileFrequency.size(), 0);
+	groupFrequency.clear();
+
+	// big files first, so small ones join the groups they shape
+	vector<size_t> order(fileFrequency.size());
+	vector<uint64_t> fileSize(fileFrequency.size());
+	for (size_t i = 0; i < fileFrequency.size(); i++)
+	{
+		order[i] = i;
+		fileSize[i] = accumulate(fileFrequency[i].begin(), fileFrequency[i].end(), uint64_t(0));
+	}
+	stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return fileSize[a] > fileSize[b]; });
+
+	vector<uint64_t> joined(256);
+	for (size_t i : order)
+	{
+		const vector<uint64_t>& freq = fileFrequency[i];
+
+		int bestGroup = -1;
+		double bestCost = 0;
+		for (size_t g = 0; g < groupFrequency.size(); g++)
+		{
+			// extra bits the group pays for taking this file: its new table codes both
+			for (int b = 0; b < 256; b++)
+				joined[b] = groupFrequency[g][b] + freq[b];
+			double cost = codedSizeBits(joined, joined) - codedSizeBits(groupFrequency[g], groupFrequency[g]);
+
+			if (bestGroup < 0 || cost < bestCost)
+			{
+				bestGroup = static_cast<int>(g);
+				bestCost = cost;
+			}
+		}
+
+		bool canOpen = static_cast<int>(groupFrequency.size()) < maxGroups;
+		if (bestGroup < 0 || (canOpen && codedSizeBits(freq, freq) + tableBits < bestCost))
+		{
+			groupFrequency.push_back(freq);
+			fileGroup[i] = static_cast<uint8_t>(groupFrequency.size() - 1);
+			continue;
+		}
+
+		for (int b = 0; b < 256; b++)
+			groupFrequency[bestGroup][b] += freq[b];
+		fileGroup[i] = static_cast<uint8_t>(bestGroup);
+	}
+
+	return fileGroup;
+}
+
 void writeFrequencyTable(const string& outputFileName, const vector<uint64_t>& byteFrequency)
 {
 	ofstream outputFile;
@@ -117,6 +214,7 @@ void printHuffmanCode(std::unordered_map<uint8_t, std::string> huffmanCodes)
 
 uint32_t compressFile(const string& needToCompressFilename, const string& tempCodeFilename, const vector<uint64_t>& byteFrequency, std::unordered_map<uint8_t, std::string> huffmanCodes)
 {
+	METRICS_TIMER(PHASE_COMPRESS);
 
 	ifstream needToCompressFile; // read from it
 	ofstream tempCodeFile; // write to it
@@ -132,10 +230,13 @@ uint32_t compressFile(const string& needToCompressFilename, const string& tempCo
 
 	string encodedString = "";
 	uint32_t length = 0;
+	uint64_t bytesRead = 0;
 	uint8_t byte;
 
 	while (needToCompressFile.read(reinterpret_cast<char*>(&byte), sizeof(byte)))
 	{
+		bytesRead++;
+		METRICS_TICK(bytesRead);
 		encodedString += huffmanCodes[byte];
 		while (encodedString.length() > 7)
 		{
@@ -157,32 +258,22 @@ uint32_t compressFile(const string& needToCompressFilename, const string& tempCo
 	tempCodeFile.put(static_cast<uint8_t>(bits.to_ulong()));
 	tempCodeFile.put(static_cast<uint8_t>(temp));
 	length += 2;
+	METRICS_BYTES(PHASE_COMPRESS, bytesRead, length);
 
 	tempCodeFile.close();
 	needToCompressFile.close();
 	return length;
 }
 
-int decompressFile(const std::string& archiveFileName, const std::string& outputFileName, const std::vector<uint64_t>& byteFrequency, std::unordered_map<uint8_t, std::string> huffmanCodes, int offset)
+int decompressFile(const std::string& archiveFileName, const std::string& outputFileName, const HuffmanTables& tables, int offset)
 {
-	auto maxLengthIt = std::max_element(
-		huffmanCodes.begin(),
-		huffmanCodes.end(),
-		[](const pair<uint8_t, string>& a, const pair<uint8_t, string>& b) {
-			return a.second.length() < b.second.length(); //   
-		}
-	);
+	METRICS_TIMER(PHASE_DECOMPRESS);
 
-	unordered_map<string, uint8_t> reverseHuffmanCodes;
-	for (const auto& pair : huffmanCodes)
-	{
-		reverseHuffmanCodes[pair.second] = pair.first;
-	}
+	const unordered_map<string, uint8_t>& reverseHuffmanCodes = tables.reverseHuffmanCodes;
 
 	ifstream archiveFile(archiveFileName, ios::binary);
-	ofstream outputFile(outputFileName, ios::binary);
 
-	if (!archiveFile.is_open() || !outputFile.is_open())
+	if (!archiveFile.is_open())
 	{
 		cerr << "   !" << endl;
 		return 0;
@@ -191,18 +282,42 @@ int decompressFile(const std::string& archiveFileName, const std::string& output
 	uint32_t compressedSize;
 	uint32_t uncompressedSize;
 
+	archiveFile.seekg(0, std::ios::end);
+	uint64_t archiveSize = archiveFile.tellg();
 	archiveFile.seekg(offset, std::ios::beg);
 
 	archiveFile.read(reinterpret_cast<char*>(&compressedSize), sizeof(compressedSize));
 	archiveFile.read(reinterpret_cast<char*>(&uncompressedSize), sizeof(uncompressedSize));
 
+	// sizes must fit in the archive, and every byte takes at least one bit
+	if (!archiveFile || compressedSize < 2
+		|| offset + sizeof(compressedSize) + sizeof(uncompressedSize) + static_cast<uint64_t>(compressedSize) > archiveSize
+		|| uncompressedSize > static_cast<uint64_t>(compressedSize) * 8)
+	{
+		cerr << "Damaged archive entry for " << outputFileName << "." << endl;
+		return 0;
+	}
+
+	OutputWriter outputFile;
+	if (!outputFile.open(outputFileName, uncompressedSize))
+	{
+		cerr << "Failed to open unpacked file " << outputFileName << " for writing." << endl;
+		return 0;
+	}
+
 	string encodedString, temp = "";
 	uint8_t byte, lastByte;
 	size_t index = 0;
 
-	for (int i = 0; i < compressedSize - 2; i++)
+	for (uint32_t i = 0; i < compressedSize - 2; i++)
 	{
 		archiveFile.read(reinterpret_cast<char*>(&byte), sizeof(byte));
+		if (!archiveFile)
+		{
+			cerr << "Damaged archive entry for " << outputFileName << "." << endl;
+			return 0;
+		}
+		METRICS_TICK(static_cast<uint64_t>(i) + 1);
 		encodedString += std::bitset<8>(byte).to_string();
 
 		while (index < encodedString.size())
@@ -223,13 +338,19 @@ int decompressFile(const std::string& archiveFileName, const std::string& output
 	archiveFile.read(reinterpret_cast<char*>(&byte), sizeof(byte));
 	archiveFile.read(reinterpret_cast<char*>(&lastByte), sizeof(lastByte));
 
+	if (!archiveFile)
+	{
+		cerr << "Damaged archive entry for " << outputFileName << "." << endl;
+		return 0;
+	}
+
 	temp = std::bitset<8>(byte).to_string();
 	temp = temp.substr(0, lastByte);
 	encodedString += temp;
 
 	index = 0;
 	temp.clear();
-	while (encodedString.size())
+	while (index < encodedString.size()) // leftover bits that match no code mean a damaged archive
 	{
 		temp += encodedString[index];
 		index++;
@@ -243,8 +364,20 @@ int decompressFile(const std::string& archiveFileName, const std::string& output
 		}
 	}
 
+	if (!temp.empty())
+	{
+		cerr << "Damaged archive entry for " << outputFileName << "." << endl;
+		return 0;
+	}
+
+	METRICS_BYTES(PHASE_DECOMPRESS, compressedSize, uncompressedSize);
+
 	offset = archiveFile.tellg();
 	archiveFile.close();
-	outputFile.close();
+	if (!outputFile.close())
+	{
+		cerr << "Failed to write unpacked file " << outputFileName << "." << endl;
+		return 0;
+	}
 	return offset;
 }
\ No newline at end of file
@@ -2,6 +2,8 @@
 #define HUFFMAN_H
 
 #include <unordered_map>
+#include <string>
+#include <vector>
 
 struct Node
 {
@@ -21,19 +23,34 @@ struct Compare
     }
 };
 
+// everything needed to code and decode with one frequency table
+struct HuffmanTables
+{
+    std::vector<uint64_t> byteFrequency;
+    std::unordered_map<uint8_t, std::string> huffmanCodes;
+    std::unordered_map<std::string, uint8_t> reverseHuffmanCodes;
+};
+
 void generateCodes(Node* root, std::string str, std::unordered_map<uint8_t, std::string>& huffmanCodes);
 
 Node* buildHuffmanTree(const std::vector<uint64_t>& byteFrequency);
 
+void buildHuffmanTables(const std::vector<uint64_t>& byteFrequency, HuffmanTables& tables);
+
 void countByteFrequency(const std::string& inputFileName, std::vector<uint64_t>& byteFrequency);
 
+// assigns every file to a group so that each group gets its own table;
+// a file starts a new group only when its own table pays for the 2048 bytes it costs
+// returns group index per file, groupFrequency gets the summed table of each group
+std::vector<uint8_t> groupFilesByFrequency(const std::vector<std::vector<uint64_t>>& fileFrequency, int maxGroups, std::vector<std::vector<uint64_t>>& groupFrequency);
+
 void writeFrequencyTable(const std::string& outputFileName, const std::vector<uint64_t>& byteFrequency);
 
 void readFrequencyTable(const std::string& inputFileName, std::vector<uint64_t>& byteFrequency, int offset);
 
 uint32_t compressFile(const std::string& inputFileName, const std::string& outputFileName, const std::vector<uint64_t>& byteFrequency, std::unordered_map<uint8_t, std::string> huffmanCodes);
 
-int decompressFile(const std::string& inputFileName, const std::string& outputFileName, const std::vector<uint64_t>& byteFrequency, std::unordered_map<uint8_t, std::string> huffmanCodes, int offset);
+int decompressFile(const std::string& inputFileName, const std::string& outputFileName, const HuffmanTables& tables, int offset);
 
 void printHuffmanCode(std::unordered_map<uint8_t, std::string> huffmanCodes);
 
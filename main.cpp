@@ -3,8 +3,19 @@
 #include <direct.h> 
 #include <filesystem>
 #include <cstdio>
+#include <unordered_set>
+#include <sstream>
+#include <random>
+#include <chrono>
+#include <map>
+#include <iomanip>
+#include <functional>
 #define HEADER_LENGTH 14
+#define MAX_FILE_GROUPS 8
 #include "huffman.h"
+#include "metrics.h"
+#include "writer.h"
+#include "dictionary.h"
 
 using namespace std;
 namespace fs = std::filesystem;
@@ -12,7 +23,7 @@ namespace fs = std::filesystem;
 const char mySignature[] = { 'K', 'r', 'i', 't', 'a', '!' };
 const int signatureLength = sizeof(mySignature);
 
-void createDirectories(const string& path);
+void createDirectories(const string& path, unordered_set<string>& createdDirectories);
 
 struct FileInfo
 {
@@ -39,10 +50,41 @@ void gatherFiles(const fs::path& dirPath, vector<FileInfo>& files)
 	}
 }
 
-void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
+void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce, const string& dictionaryName = "", const string& archiveName = "archive.krit")
 {
+	METRICS_RESET();
 	string tempFilename = "temp";
-	string archiveName = "archive.krit"; // name of archive
+
+	HuffmanTables archiveTables;
+	const HuffmanTables* tables = &archiveTables;
+	uint32_t dictionaryId = 0;
+
+	if (compressAndInterfernce == 2)
+	{
+		tables = loadDictionary(dictionaryName, dictionaryId);
+		if (!tables)
+			return;
+	}
+
+	vector<uint8_t> fileGroup;
+	vector<vector<uint64_t>> groupFrequency;
+	vector<HuffmanTables> groupTables;
+
+	if (compressAndInterfernce == 3)
+	{
+		vector<vector<uint64_t>> fileFrequency(files.size(), vector<uint64_t>(256, 0));
+		for (size_t i = 0; i < files.size(); i++)
+		{
+			countByteFrequency(files[i].relativePath, fileFrequency[i]);
+		}
+
+		fileGroup = groupFilesByFrequency(fileFrequency, MAX_FILE_GROUPS, groupFrequency);
+		groupTables.resize(groupFrequency.size());
+		for (size_t g = 0; g < groupFrequency.size(); g++)
+		{
+			buildHuffmanTables(groupFrequency[g], groupTables[g]);
+		}
+	}
 
 	ofstream tempFile;
 
@@ -68,16 +110,32 @@ void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
 	{
 		extraFieldLengthValue = 256 * 8; // for frequency table
 	}
+	if (compressAndInterfernce == 2)
+	{
+		extraFieldLengthValue = sizeof(dictionaryId); // only the dictionary id
+	}
+	if (compressAndInterfernce == 3)
+	{
+		extraFieldLengthValue = static_cast<uint16_t>(1 + groupFrequency.size() * 256 * 8); // group count and a table per group
+	}
 
 	uint16_t offsetFilesStart = HEADER_LENGTH + extraFieldLengthValue;
 	tempFile.write(reinterpret_cast<char*>(&offsetFilesStart), sizeof(offsetFilesStart));
 	tempFile.write(reinterpret_cast<char*>(&extraFieldLengthValue), sizeof(extraFieldLengthValue));
 	tempFile.close();
 
+	uint64_t bytesTotal = 0;
+	uint64_t bytesDone = 0;
+	for (const auto& file : files)
+	{
+		bytesTotal += file.size;
+	}
+
 	if (compressAndInterfernce == 0) // no compression, just copy data
 	{
 		for (const auto& file : files)
 		{
+			METRICS_TIMER(PHASE_COPY);
 			tempFile.open(tempFilename, ios::binary | ios::app);
 
 			ifstream inputFile;
@@ -103,23 +161,47 @@ void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
 			tempFile << inputFile.rdbuf();
 			inputFile.close();
 			tempFile.close();
+
+			METRICS_BYTES(PHASE_COPY, originalSize, originalSize);
+			bytesDone += originalSize;
+			METRICS_PROGRESS(file.relativePath, bytesDone, bytesTotal);
 		}
 	}
-	if (compressAndInterfernce == 1) // huffman compression
+	if (compressAndInterfernce == 1 || compressAndInterfernce == 2 || compressAndInterfernce == 3) // huffman compression
 	{
-		vector<uint64_t> byteFrequency(256, 0);
-		for (const auto& file : files)
+		if (compressAndInterfernce == 1)
 		{
-			countByteFrequency(file.relativePath, byteFrequency);
+			vector<uint64_t> byteFrequency(256, 0);
+			for (const auto& file : files)
+			{
+				countByteFrequency(file.relativePath, byteFrequency);
+			}
+
+			writeFrequencyTable(tempFilename, byteFrequency);
+			buildHuffmanTables(byteFrequency, archiveTables);
 		}
+		if (compressAndInterfernce == 2)
+		{
+			tempFile.open(tempFilename, ios::binary | ios::app);
+			tempFile.write(reinterpret_cast<char*>(&dictionaryId), sizeof(dictionaryId));
+			tempFile.close();
+		}
+		if (compressAndInterfernce == 3)
+		{
+			uint8_t groupCount = static_cast<uint8_t>(groupFrequency.size());
+			tempFile.open(tempFilename, ios::binary | ios::app);
+			tempFile.write(reinterpret_cast<char*>(&groupCount), sizeof(groupCount));
+			tempFile.close();
 
-		writeFrequencyTable(tempFilename, byteFrequency);
-		Node* root = buildHuffmanTree(byteFrequency);
-		unordered_map<uint8_t, string> huffmanCodes;
-		generateCodes(root, "", huffmanCodes);
+			for (const auto& frequency : groupFrequency)
+			{
+				writeFrequencyTable(tempFilename, frequency);
+			}
+		}
 
-		for (const auto& file : files)
+		for (size_t i = 0; i < files.size(); i++)
 		{
+			const FileInfo& file = files[i];
 			tempFile.open(tempFilename, ios::binary | ios::app);
 
 			ifstream fileToCode;
@@ -138,10 +220,16 @@ void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
 			tempFile.write(reinterpret_cast<char*>(&nameLength), sizeof(nameLength));
 			tempFile.write(file.relativePath.c_str(), nameLength);
 
+			if (compressAndInterfernce == 3)
+			{
+				tables = &groupTables[fileGroup[i]];
+				tempFile.write(reinterpret_cast<const char*>(&fileGroup[i]), sizeof(fileGroup[i]));
+			}
+
 			tempFile.close();
 
 			string filenameWhereTempCode = "wgfuiwgfuiw";
-			uint32_t compressedSize = compressFile(file.relativePath, filenameWhereTempCode, byteFrequency, huffmanCodes);
+			uint32_t compressedSize = compressFile(file.relativePath, filenameWhereTempCode, tables->byteFrequency, tables->huffmanCodes);
 
 			tempFile.open(tempFilename, ios::binary | ios::app);
 			tempFile.write(reinterpret_cast<char*>(&compressedSize), sizeof(compressedSize));
@@ -155,9 +243,11 @@ void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
 			fileToCode.close();
 			tempFile.close();
 			remove(filenameWhereTempCode.c_str());
+
+			bytesDone += originalSize;
+			METRICS_PROGRESS(file.relativePath, bytesDone, bytesTotal);
 		}
 
-		delete root;
 		tempFile.close();
 	}
 
@@ -168,11 +258,16 @@ void Coder(const vector<FileInfo>& files, uint16_t compressAndInterfernce)
 		return;
 	}
 	
+	METRICS_WRITE();
 	cout << "Files successfully archived into " << archiveName << "." << endl;
 }
 
 bool Decoder(const string& inputFile)
 {
+	METRICS_RESET();
+
+	unordered_set<string> createdDirectories; // directories already made by this extraction
+
 	ifstream file;
 	file.open(inputFile, ios::binary);
 
@@ -227,33 +322,88 @@ bool Decoder(const string& inputFile)
 			file.read(reinterpret_cast<char*>(&compressedSize), sizeof(compressedSize));
 			file.read(reinterpret_cast<char*>(&uncompressedSize), sizeof(uncompressedSize));
 
-			createDirectories(unpackedFilename);
-			ofstream unpackedFile(unpackedFilename, ios::binary);
+			if (!file || compressedSize != uncompressedSize || static_cast<uint64_t>(file.tellg()) + compressedSize > static_cast<uint64_t>(fileSize))
+			{
+				cerr << "Damaged archive entry for " << unpackedFilename << "." << endl;
+				return false;
+			}
+
+			METRICS_TIMER(PHASE_COPY);
+			createDirectories(unpackedFilename, createdDirectories);
+			OutputWriter unpackedFile;
 
-			if (!unpackedFile.is_open())
+			if (!unpackedFile.open(unpackedFilename, uncompressedSize))
 			{
 				cerr << "Failed to open unpacked file " << unpackedFilename << " for writing." << endl;
 				return false;
 			}
 
-			vector<char> buffer(compressedSize);
-			file.read(buffer.data(), compressedSize);
-			unpackedFile.write(buffer.data(), uncompressedSize);
-			unpackedFile.close();
+			// copy in large chunks instead of holding the whole file in memory
+			vector<char> buffer(min<uint32_t>(compressedSize, WRITER_BUFFER_SIZE));
+			uint32_t left = compressedSize;
+			while (left > 0)
+			{
+				uint32_t part = min<uint32_t>(left, static_cast<uint32_t>(buffer.size()));
+				file.read(buffer.data(), part);
+				if (!file)
+				{
+					cerr << "Damaged archive entry for " << unpackedFilename << "." << endl;
+					return false;
+				}
+				unpackedFile.write(buffer.data(), part);
+				left -= part;
+			}
+
+			if (!unpackedFile.close())
+			{
+				cerr << "Failed to write unpacked file " << unpackedFilename << "." << endl;
+				return false;
+			}
+			METRICS_BYTES(PHASE_COPY, compressedSize, uncompressedSize);
+			METRICS_PROGRESS(unpackedFilename, static_cast<uint64_t>(file.tellg()), fileSize);
 			cout << "Successfully created unpacked file: " << unpackedFilename << endl;
 		}
 
 		file.close();
+		METRICS_WRITE();
 		return true;
 	} 
-	if (compressAndInterfernce == 1) // huffman comression
+	if (compressAndInterfernce == 1 || compressAndInterfernce == 2 || compressAndInterfernce == 3) // huffman comression
 	{
-		std::vector<uint64_t> byteFrequency;
-		readFrequencyTable(inputFile, byteFrequency, 14);
-		Node* root = buildHuffmanTree(byteFrequency);
+		HuffmanTables archiveTables;
+		const HuffmanTables* tables = &archiveTables;
+		vector<HuffmanTables> groupTables;
 
-		unordered_map<uint8_t, string> huffmanCodes;
-		generateCodes(root, "", huffmanCodes);
+		if (compressAndInterfernce == 1)
+		{
+			std::vector<uint64_t> byteFrequency;
+			readFrequencyTable(inputFile, byteFrequency, 14);
+			buildHuffmanTables(byteFrequency, archiveTables);
+		}
+		if (compressAndInterfernce == 2)
+		{
+			uint32_t dictionaryId;
+			file.read(reinterpret_cast<char*>(&dictionaryId), sizeof(dictionaryId));
+			tables = findDictionary(dictionaryId);
+			if (!tables)
+			{
+				cerr << "Dictionary " << dictionaryFileName(dictionaryId) << " is needed to decode this archive." << endl;
+				return false;
+			}
+		}
+		if (compressAndInterfernce == 3)
+		{
+			uint8_t groupCount;
+			file.read(reinterpret_cast<char*>(&groupCount), sizeof(groupCount));
+			groupTables.resize(groupCount);
+
+			for (int g = 0; g < groupCount; g++)
+			{
+				std::vector<uint64_t> byteFrequency;
+				readFrequencyTable(inputFile, byteFrequency, HEADER_LENGTH + 1 + g * 256 * 8);
+				buildHuffmanTables(byteFrequency, groupTables[g]);
+			}
+		}
 
 		while (1)
 		{
@@ -271,25 +421,33 @@ bool Decoder(const string& inputFile)
 
 			delete[] filenameBuffer;
 
-			createDirectories(unpackedFilename);
-			ofstream unpackedFile(unpackedFilename, ios::binary);
-
-			if (!unpackedFile.is_open())
+			if (compressAndInterfernce == 3)
 			{
-				cerr << "Failed to open unpacked file " << unpackedFilename << " for writing." << endl;
-				return false;
+				uint8_t group;
+				file.read(reinterpret_cast<char*>(&group), sizeof(group));
+				if (group >= groupTables.size())
+				{
+					cerr << "Invalid file group in the archive." << endl;
+					return false;
+				}
+				tables = &groupTables[group];
 			}
 
+			createDirectories(unpackedFilename, createdDirectories);
+
 			offset = file.tellg();
-			offset = decompressFile(inputFile, unpackedFilename, byteFrequency, huffmanCodes, offset);
+			offset = decompressFile(inputFile, unpackedFilename, *tables, offset);
+			if (offset == 0)
+				return false;
 
-			unpackedFile.close();
+			METRICS_PROGRESS(unpackedFilename, offset, fileSize);
 			cout << "Successfully created unpacked file: " << unpackedFilename << endl;
 			if (offset > fileSize - 1)
 				break;
 		}
 
 		file.close();
+		METRICS_WRITE();
 		return true;
 	}
 	return false;
@@ -301,30 +459,25 @@ bool fileExists(const string& filename)
 	return fileStream.good();
 }
 
-void createDirectories(const string& path)
+void createDirectories(const string& path, unordered_set<string>& createdDirectories)
 {
 	string currentPath;
 
-	size_t pos = 0;
+	size_t pos = path.find_last_of('/');
 
-	if (path.find('/') == std::string::npos)
-	{
-		std::ofstream file(path);
-		return;
-	}
+	if (pos == std::string::npos || createdDirectories.count(path.substr(0, pos)))
+		return; // the file itself is created by the writer
 
+	pos = 0;
 	while ((pos = path.find('/', pos)) != string::npos)
 	{
 		currentPath = path.substr(0, pos);
 
-		_mkdir(currentPath.c_str());
+		if (!createdDirectories.count(currentPath) && (_mkdir(currentPath.c_str()) == 0 || fs::is_directory(currentPath)))
+			createdDirectories.insert(currentPath);
 
 		pos++; // Move to next character after '/'
 	}
-
-	// create a file (if no dir, just file)
-	currentPath = path.substr(0, path.find_last_of('/'));
-	_mkdir(currentPath.c_str());
 }
 
 uint16_t askForCompress() // to choose compression method
@@ -332,6 +485,8 @@ uint16_t askForCompress() // to choose compression method
 	cout << "\n\Compression methods:\n";
 	cout << "1) No\n";
 	cout << "2) Huffman\n";
+	cout << "3) Huffman with a shared dictionary\n";
+	cout << "4) Huffman with a table per group of similar files\n";
 	cout << "Choose an option: ";
 
 	int choice;
@@ -354,18 +509,438 @@ uint16_t askForCompress() // to choose compression method
 		return 2;
 		break;
 	}
+	case 4:
+	{
+		return 3;
+		break;
+	}
+	}
+}
+
+#ifdef KRIT_METRICS
+void askForMetrics() // where and how often to write JSON metrics
+{
+	string metricsPath;
+	cout << "Enter the metrics file name (\"-\" for stderr): ";
+	std::cin >> metricsPath;
+
+	uint32_t interval;
+	cout << "Enter the reporting interval in milliseconds (0 - only at the end): ";
+	std::cin >> interval;
+
+	setMetricsOutput(metricsPath == "-" ? "" : metricsPath);
+	setMetricsInterval(interval);
+}
+#endif
+
+string askForDictionary() // for "Huffman with a shared dictionary"
+{
+	string dictionaryName;
+	cout << "Enter the dictionary file name: ";
+	std::cin >> dictionaryName;
+	return dictionaryName;
+}
+
+void trainDictionaryFromDirectory()
+{
+	string dirPath;
+	cout << "Enter the full path of the directory with sample files: ";
+	std::cin >> dirPath;
+
+	if (!fs::exists(dirPath) || !fs::is_directory(dirPath))
+	{
+		cout << "Directory does not exist: " << dirPath << ". Please try again.\n";
+		return;
+	}
+
+	vector<FileInfo> files;
+	gatherFiles(dirPath, files);
+
+	vector<string> sampleFileNames;
+	for (const auto& file : files)
+	{
+		sampleFileNames.push_back(file.relativePath);
+	}
+
+	vector<uint64_t> byteFrequency;
+	uint32_t id = trainDictionary(sampleFileNames, byteFrequency);
+	string dictionaryName = dictionaryFileName(id);
+
+	if (saveDictionary(dictionaryName, id, byteFrequency))
+	{
+		cout << "Dictionary trained on " << files.size() << " files and saved into " << dictionaryName << "." << endl;
+	}
+}
+
+struct SelfCheckCase
+{
+	string name;
+	string content;
+};
+
+// inputs that have broken the coder before, plus seeded random ones
+vector<SelfCheckCase> makeSelfCheckCases(uint32_t seed)
+{
+	mt19937 random(seed);
+	vector<SelfCheckCase> cases;
+
+	cases.push_back({ "empty", "" });
+	cases.push_back({ "one_byte", "x" });
+	cases.push_back({ "one_symbol", string(5000, 'a') });
+
+	string uniform;
+	for (int i = 0; i < 256 * 64; i++)
+		uniform += static_cast<char>(i % 256);
+	cases.push_back({ "uniform256", uniform });
+
+	string skewed; // very long and very short codes together
+	for (int i = 0; i < 40000; i++)
+		skewed += static_cast<char>(random() % 1000 == 0 ? random() % 256 : 'e');
+	cases.push_back({ "skewed", skewed });
+
+	string huge; // several writer buffers plus a partial one
+	for (int i = 0; i < (3 << 20) + 4099; i++)
+		huge += static_cast<char>(random() % 16 == 0 ? random() % 256 : "etaoin shrdlu"[random() % 13]);
+	cases.push_back({ "huge", huge });
+
+	for (int n = 0; n < 4; n++)
+	{
+		uint32_t alphabet = 1 + random() % 256;
+		string fuzz(random() % 20000, '\0');
+		for (auto& c : fuzz)
+			c = static_cast<char>(random() % alphabet);
+		cases.push_back({ "fuzz" + to_string(n), fuzz });
+	}
+
+	return cases;
+}
+
+string readWholeFile(const string& fileName)
+{
+	ifstream inputFile(fileName, ios::binary);
+	ostringstream content;
+	content << inputFile.rdbuf();
+	return content.str();
+}
+
+struct SelfCheckResult
+{
+	double encode = 0;
+	double decode = 0;
+	string checksum = "";
+};
+
+// results file: "seed <seed>", then one "method case encodeMBs decodeMBs archiveChecksum" line per run
+map<string, SelfCheckResult> readSelfCheckResults(const string& fileName, uint32_t& seed)
+{
+	map<string, SelfCheckResult> results;
+	ifstream inputFile(fileName);
+	if (!inputFile)
+	{
+		cerr << "Failed to open self check results file: " << fileName << endl;
+		return results;
+	}
+
+	string line;
+	while (getline(inputFile, line))
+	{
+		istringstream fields(line);
+		string method, caseName;
+		fields >> method;
+		if (method == "seed")
+		{
+			fields >> seed;
+			continue;
+		}
+
+		SelfCheckResult result;
+		if (fields >> caseName >> result.encode >> result.decode)
+		{
+			fields >> result.checksum;
+			results[method + " " + caseName] = result;
+		}
+	}
+	return results;
+}
+
+// FNV-1a of the whole archive, so archives made by different builds can be compared
+string archiveChecksum(const string& fileName)
+{
+	string content = readWholeFile(fileName);
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : content)
+	{
+		hash ^= static_cast<uint8_t>(c);
+		hash *= 1099511628211ull;
 	}
+
+	ostringstream text;
+	text << hex << setw(16) << setfill('0') << hash;
+	return text.str();
 }
 
-int main()
+void patchFile(const string& fileName, uint64_t position, const void* data, size_t length)
 {
+	fstream file(fileName, ios::binary | ios::in | ios::out);
+	file.seekp(position, ios::beg);
+	file.write(static_cast<const char*>(data), length);
+}
+
+// encodes and decodes every case with every method, compares bytes and prints throughput;
+// damaged archives must be rejected. Everything happens in a fresh temporary directory.
+// resultsName - where to save throughput and archive checksums,
+// baselineName - results of an earlier build: different archives for the same seed are failures
+int runSelfCheck(uint32_t seed, const string& resultsName = "", const string& baselineName = "")
+{
+	const string archiveName = "selfcheck.krit";
+	const char* methodNames[] = { "none", "huffman", "dictionary", "groups" };
+
+	map<string, SelfCheckResult> baseline;
+	uint32_t baselineSeed = seed;
+	if (!baselineName.empty())
+		baseline = readSelfCheckResults(baselineName, baselineSeed);
+	if (baselineSeed != seed)
+		cout << "Baseline was made with seed " << baselineSeed << ", archives are not compared." << endl;
+
+	ofstream resultsFile;
+	if (!resultsName.empty())
+	{
+		resultsFile.open(fs::absolute(resultsName));
+		if (!resultsFile)
+		{
+			cerr << "Failed to open self check results file for writing: " << resultsName << endl;
+			return 1;
+		}
+		resultsFile << "seed " << seed << "\n";
+	}
+
+	// Coder and Decoder work in the current directory, so move into our own one
+	fs::path startDir = fs::current_path();
+	fs::path workDir;
+	mt19937 dirRandom(random_device{}());
+	do
+	{
+		workDir = fs::temp_directory_path() / ("krit_selfcheck_" + to_string(dirRandom()));
+	} while (!fs::create_directory(workDir));
+	fs::current_path(workDir);
+	METRICS_QUIET(true); // every Coder and Decoder run would print its metrics
+
+	vector<SelfCheckCase> cases = makeSelfCheckCases(seed);
+	SelfCheckCase allCases = { "all", "" };
+	cases.push_back(allCases); // every case in one archive
+
+	fs::create_directories("cases");
+	vector<FileInfo> allFiles;
+	for (const auto& testCase : cases)
+	{
+		if (testCase.name == "all") continue;
+		string fileName = "cases/" + testCase.name;
+		ofstream(fileName, ios::binary).write(testCase.content.data(), testCase.content.size());
+		allFiles.push_back({ fileName, static_cast<uint32_t>(testCase.content.size()) });
+	}
+
+	// a dictionary trained on the cases themselves
+	vector<string> sampleFileNames;
+	for (const auto& file : allFiles)
+		sampleFileNames.push_back(file.relativePath);
+	vector<uint64_t> byteFrequency;
+	uint32_t dictionaryId = trainDictionary(sampleFileNames, byteFrequency);
+	string dictionaryName = dictionaryFileName(dictionaryId);
+	saveDictionary(dictionaryName, dictionaryId, byteFrequency);
+
+	int failures = 0;
+	streambuf* coutBuffer = cout.rdbuf();
+	streambuf* cerrBuffer = cerr.rdbuf();
+	ostringstream quiet;
+
+	for (uint16_t method = 0; method < 4; method++)
+	{
+		for (size_t c = 0; c < cases.size(); c++)
+		{
+			vector<FileInfo> files;
+			if (cases[c].name == "all")
+				files = allFiles;
+			else
+				files.push_back(allFiles[c]);
+
+			uint64_t totalSize = 0;
+			for (const auto& file : files)
+				totalSize += file.size;
+
+			cout.rdbuf(quiet.rdbuf()); // Coder and Decoder report every file
+			auto start = chrono::steady_clock::now();
+			Coder(files, method, dictionaryName, archiveName);
+			auto encoded = chrono::steady_clock::now();
+
+			for (const auto& file : files)
+				std::remove(file.relativePath.c_str());
+
+			bool ok = Decoder(archiveName);
+			auto decoded = chrono::steady_clock::now();
+			cout.rdbuf(coutBuffer);
+			quiet.str("");
+
+			for (const auto& file : files)
+			{
+				size_t index = &file - files.data();
+				const string& expected = cases[cases[c].name == "all" ? index : c].content;
+				if (!fs::exists(file.relativePath) || readWholeFile(file.relativePath) != expected)
+				{
+					ok = false;
+					ofstream(file.relativePath, ios::binary).write(expected.data(), expected.size()); // next runs need it
+				}
+			}
+
+			double encodeSeconds = chrono::duration<double>(encoded - start).count();
+			double decodeSeconds = chrono::duration<double>(decoded - encoded).count();
+			double encodeSpeed = totalSize / encodeSeconds / (1024 * 1024);
+			double decodeSpeed = totalSize / decodeSeconds / (1024 * 1024);
+			string key = string(methodNames[method]) + " " + cases[c].name;
+
+			string checksum = archiveChecksum(archiveName);
+			auto before = baseline.find(key);
+			bool archiveDiffers = before != baseline.end() && baselineSeed == seed && !before->second.checksum.empty() && before->second.checksum != checksum;
+			if (archiveDiffers)
+				ok = false;
+
+			cout << (ok ? "[OK]   " : "[FAIL] ") << key
+				<< " (" << totalSize << " bytes -> " << (fs::exists(archiveName) ? fs::file_size(archiveName) : 0) << ")"
+				<< ": encode " << encodeSpeed << " MB/s"
+				<< ", decode " << decodeSpeed << " MB/s";
+
+			if (before != baseline.end() && before->second.encode > 0 && before->second.decode > 0)
+			{
+				cout << " [vs baseline: encode " << showpos << static_cast<int>((encodeSpeed / before->second.encode - 1) * 100)
+					<< "%, decode " << static_cast<int>((decodeSpeed / before->second.decode - 1) * 100) << "%" << noshowpos << "]";
+			}
+			if (archiveDiffers)
+				cout << " [archive differs from baseline]";
+			cout << endl;
+
+			if (resultsFile.is_open())
+				resultsFile << key << " " << encodeSpeed << " " << decodeSpeed << " " << checksum << "\n";
+
+			if (!ok)
+				failures++;
+		}
+	}
+
+	// damaged archives: each must make Decoder fail instead of unpacking garbage or hanging
+	auto findCaseFile = [&](const string& name) {
+		for (const auto& file : allFiles)
+		{
+			if (file.relativePath == "cases/" + name)
+				return file;
+		}
+		throw logic_error("no self check case named " + name);
+	};
+	FileInfo uniformFile = findCaseFile("uniform256"); // all codes 8 bits long, no padding in the last byte
+	FileInfo hugeFile = findCaseFile("huge");
+	uint64_t huffmanEntrySize = HEADER_LENGTH + 256 * 8 + 1 + uniformFile.relativePath.size(); // where the sizes start
+
+	struct DamagedCase
+	{
+		string name;
+		FileInfo file;
+		uint16_t method;
+		std::function<void()> damage;
+	};
+	vector<DamagedCase> damagedCases = {
+		{ "size_below_2", uniformFile, 1, [&]() { uint32_t size = 1; patchFile(archiveName, huffmanEntrySize, &size, sizeof(size)); } },
+		{ "bits_match_no_code", uniformFile, 1, [&]() { uint8_t bits = 3; patchFile(archiveName, fs::file_size(archiveName) - 1, &bits, sizeof(bits)); } },
+		{ "truncated_huffman", uniformFile, 1, [&]() { fs::resize_file(archiveName, fs::file_size(archiveName) / 2); } },
+		{ "huge_compressed_size", uniformFile, 1, [&]() { uint32_t size = 0xFFFFFFF0; patchFile(archiveName, huffmanEntrySize, &size, sizeof(size)); } },
+		{ "truncated_stored", hugeFile, 0, [&]() { fs::resize_file(archiveName, fs::file_size(archiveName) / 2); } },
+	};
+
+	for (const auto& damaged : damagedCases)
+	{
+		cout.rdbuf(quiet.rdbuf());
+		cerr.rdbuf(quiet.rdbuf()); // the errors are expected here
+		Coder({ damaged.file }, damaged.method, dictionaryName, archiveName);
+		damaged.damage();
+		bool ok = !Decoder(archiveName);
+		cout.rdbuf(coutBuffer);
+		cerr.rdbuf(cerrBuffer);
+		quiet.str("");
+
+		cout << (ok ? "[OK]   " : "[FAIL] ") << "damaged " << damaged.name << (ok ? ": rejected" : ": accepted") << endl;
+		if (!ok)
+			failures++;
+	}
+
+	METRICS_QUIET(false);
+	fs::current_path(startDir);
+	fs::remove_all(workDir);
+
+	cout << "Self check with seed " << seed << ": " << failures << " failed." << endl;
+	return failures;
+}
+
+int main(int argc, char* argv[])
+{
+	// non-interactive mode for scripts: --selfcheck <seed> [--results <file>] [--baseline <file>]
+	if (argc > 1)
+	{
+		uint32_t seed = 0;
+		string resultsName = "";
+		string baselineName = "";
+		bool selfCheck = false;
+
+		for (int i = 1; i < argc; i++)
+		{
+			string arg = argv[i];
+			if (arg == "--selfcheck" && i + 1 < argc)
+			{
+				try
+				{
+					seed = static_cast<uint32_t>(stoul(argv[++i]));
+					selfCheck = true;
+				}
+				catch (const exception&)
+				{
+					selfCheck = false; // not a number
+					break;
+				}
+			}
+			else if (arg == "--results" && i + 1 < argc)
+				resultsName = argv[++i];
+			else if (arg == "--baseline" && i + 1 < argc)
+				baselineName = argv[++i];
+			else
+			{
+				selfCheck = false; // unknown argument
+				break;
+			}
+		}
+
+		if (!selfCheck)
+		{
+			cerr << "Usage: " << argv[0] << " --selfcheck <seed> [--results <file>] [--baseline <file>]" << endl;
+			return 2;
+		}
+		return runSelfCheck(seed, resultsName, baselineName) == 0 ? 0 : 1;
+	}
+
+#ifdef KRIT_METRICS
+	setProgressCallback([](const string& fileName, uint64_t bytesDone, uint64_t bytesTotal) {
+		int percent = bytesTotal ? static_cast<int>(bytesDone * 100 / bytesTotal) : 100;
+		cout << "[" << percent << "%] " << fileName << endl;
+	});
+#endif
+
 	while (true)
 	{
 		cout << "\n\tMenu:\n";
 		cout << "1) Encode specific files\n";
 		cout << "2) Encode all files in a directory\n";
 		cout << "3) Decode an archive\n";
+		cout << "4) Train a shared dictionary\n";
+#ifdef KRIT_METRICS
+		cout << "5) Metrics settings\n";
+#endif
 		cout << "6) Exit\n";
+		cout << "7) Run a round-trip self check\n";
 		cout << "Choose an option: ";
 
 		int choice;
@@ -398,11 +973,13 @@ int main()
 				}
 
 				files[i].relativePath = filepath;
+				files[i].size = static_cast<uint32_t>(fs::file_size(filepath));
 			}
 
 			uint16_t comp = askForCompress();
+			string dictionaryName = comp == 2 ? askForDictionary() : "";
 
-			Coder(files, comp);
+			Coder(files, comp, dictionaryName);
 			break;
 		}
 		case 2:
@@ -427,8 +1004,9 @@ int main()
 			}
 
 			uint16_t comp = askForCompress();
+			string dictionaryName = comp == 2 ? askForDictionary() : "";
 
-			Coder(files, comp);
+			Coder(files, comp, dictionaryName);
 			break;
 		}
 		case 3:
@@ -449,33 +1027,25 @@ int main()
 		}
 		case 4:
 		{
-			int numFiles;
-			cout << "Enter number of files to encode: ";
-			std::cin >> numFiles;
-
-			vector<FileInfo> files(numFiles);
-
-			for (int i = 0; i < numFiles; ++i)
-			{
-				cout << "Enter the full path of the file to encode: ";
-				string filepath;
-				std::cin >> filepath;
-
-				if (!fileExists(filepath))
-				{
-					cout << "File does not exist: " << filepath << ". Please try again.\n";
-					--i;
-					continue;
-				}
-
-				files[i].relativePath = filepath;
-			}
-
-			uint16_t comp = askForCompress();
+			trainDictionaryFromDirectory();
+			break;
+		}
+		case 7:
+		{
+			uint32_t seed;
+			cout << "Enter a seed for random inputs: ";
+			std::cin >> seed;
 
-			Coder(files, comp);
+			runSelfCheck(seed);
+			break;
+		}
+#ifdef KRIT_METRICS
+		case 5:
+		{
+			askForMetrics();
 			break;
 		}
+#endif
 		default:
 			cout << "Invalid option. Please choose again.\n";
 			break;
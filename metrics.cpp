@@ -0,0 +1,264 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <vector>
+#include "metrics.h"
+
+using namespace std;
+
+static const char* phaseNames[PHASE_TOTAL] = { "count_frequency", "build_tree", "compress", "decompress", "copy" };
+
+struct PhaseStats
+{
+	atomic<uint64_t> nanoseconds{ 0 };
+	atomic<uint64_t> bytesIn{ 0 };
+	atomic<uint64_t> bytesOut{ 0 };
+};
+
+struct ThreadStats
+{
+	int id;
+	PhaseStats phases[PHASE_TOTAL];
+	atomic<int> currentPhase{ -1 }; // -1 - nothing running
+	atomic<uint64_t> currentStart{ 0 };
+	atomic<uint64_t> currentBytes{ 0 };
+};
+
+static mutex statsMutex; // guards allThreads and everything below
+static vector<unique_ptr<ThreadStats>> allThreads;
+static ProgressCallback progressCallback;
+static string metricsFileName = "";
+static uint32_t metricsInterval = 0;
+static uint64_t lastWrite = 0;
+static string lastFileName = "";
+static uint64_t lastBytesDone = 0;
+static uint64_t lastBytesTotal = 0;
+static bool metricsQuiet = false;
+
+static uint64_t nowNanoseconds()
+{
+	return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static uint64_t startTime = nowNanoseconds(); // guarded by statsMutex, moved by resetMetrics()
+
+// each thread writes only to its own counters, so the hot path never takes the lock
+static ThreadStats& threadStats()
+{
+	thread_local ThreadStats* stats = nullptr;
+	if (!stats)
+	{
+		lock_guard<mutex> lock(statsMutex);
+		allThreads.push_back(make_unique<ThreadStats>());
+		stats = allThreads.back().get();
+		stats->id = static_cast<int>(allThreads.size()) - 1;
+	}
+	return *stats;
+}
+
+PhaseTimer::PhaseTimer(MetricsPhase p) : phase(p), start(nowNanoseconds())
+{
+	ThreadStats& stats = threadStats();
+	previousPhase = stats.currentPhase.exchange(p, memory_order_relaxed);
+	previousStart = stats.currentStart.exchange(start, memory_order_relaxed);
+	previousBytes = stats.currentBytes.exchange(0, memory_order_relaxed);
+}
+
+PhaseTimer::~PhaseTimer()
+{
+	metricsAddTime(phase, nowNanoseconds() - start);
+
+	ThreadStats& stats = threadStats();
+	stats.currentPhase.store(previousPhase, memory_order_relaxed);
+	stats.currentStart.store(previousStart, memory_order_relaxed);
+	stats.currentBytes.store(previousBytes, memory_order_relaxed);
+}
+
+void metricsAddTime(MetricsPhase phase, uint64_t nanoseconds)
+{
+	threadStats().phases[phase].nanoseconds.fetch_add(nanoseconds, memory_order_relaxed);
+}
+
+void metricsAddBytes(MetricsPhase phase, uint64_t bytesIn, uint64_t bytesOut)
+{
+	PhaseStats& stats = threadStats().phases[phase];
+	stats.bytesIn.fetch_add(bytesIn, memory_order_relaxed);
+	stats.bytesOut.fetch_add(bytesOut, memory_order_relaxed);
+}
+
+void resetMetrics()
+{
+	lock_guard<mutex> lock(statsMutex);
+	for (auto& stats : allThreads)
+	{
+		for (auto& phase : stats->phases)
+		{
+			phase.nanoseconds.store(0, memory_order_relaxed);
+			phase.bytesIn.store(0, memory_order_relaxed);
+			phase.bytesOut.store(0, memory_order_relaxed);
+		}
+	}
+
+	lastFileName = "";
+	lastBytesDone = 0;
+	lastBytesTotal = 0;
+	startTime = nowNanoseconds();
+	lastWrite = startTime;
+}
+
+void setMetricsQuiet(bool quiet)
+{
+	lock_guard<mutex> lock(statsMutex);
+	metricsQuiet = quiet;
+}
+
+void setProgressCallback(ProgressCallback callback)
+{
+	lock_guard<mutex> lock(statsMutex);
+	progressCallback = callback;
+}
+
+void setMetricsOutput(const string& outputFileName)
+{
+	lock_guard<mutex> lock(statsMutex);
+	metricsFileName = outputFileName;
+}
+
+void setMetricsInterval(uint32_t milliseconds)
+{
+	lock_guard<mutex> lock(statsMutex);
+	metricsInterval = milliseconds;
+}
+
+static void writePhases(ostringstream& out, const uint64_t (&values)[PHASE_TOTAL][3])
+{
+	out << "{";
+	for (int i = 0; i < PHASE_TOTAL; i++)
+	{
+		double seconds = values[i][0] / 1e9;
+		double throughput = seconds > 0 ? values[i][1] / seconds / (1024.0 * 1024.0) : 0.0;
+		out << (i ? "," : "") << "\"" << phaseNames[i] << "\":{"
+			<< "\"time_ms\":" << values[i][0] / 1000000
+			<< ",\"bytes_in\":" << values[i][1]
+			<< ",\"bytes_out\":" << values[i][2]
+			<< ",\"mb_per_s\":" << throughput << "}";
+	}
+	out << "}";
+}
+
+static string escapeJson(const string& str)
+{
+	string result;
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\') result += '\\';
+		if (static_cast<unsigned char>(c) < 0x20) continue;
+		result += c;
+	}
+	return result;
+}
+
+// statsMutex must be held
+static void writeMetricsLocked()
+{
+	if (metricsQuiet)
+		return;
+
+	uint64_t now = nowNanoseconds();
+	uint64_t total[PHASE_TOTAL][3] = {};
+	ostringstream threads;
+	threads << "[";
+
+	for (size_t t = 0; t < allThreads.size(); t++)
+	{
+		uint64_t values[PHASE_TOTAL][3];
+		for (int i = 0; i < PHASE_TOTAL; i++)
+		{
+			values[i][0] = allThreads[t]->phases[i].nanoseconds.load(memory_order_relaxed);
+			values[i][1] = allThreads[t]->phases[i].bytesIn.load(memory_order_relaxed);
+			values[i][2] = allThreads[t]->phases[i].bytesOut.load(memory_order_relaxed);
+			for (int j = 0; j < 3; j++)
+				total[i][j] += values[i][j];
+		}
+		// the phase still running is not in the totals yet, so show it separately
+		int current = allThreads[t]->currentPhase.load(memory_order_relaxed);
+		threads << (t ? "," : "") << "{\"id\":" << allThreads[t]->id << ",\"current_phase\":";
+		if (current < 0)
+			threads << "null";
+		else
+			threads << "{\"name\":\"" << phaseNames[current] << "\",\"elapsed_ms\":"
+				<< (now - allThreads[t]->currentStart.load(memory_order_relaxed)) / 1000000
+				<< ",\"bytes_done\":" << allThreads[t]->currentBytes.load(memory_order_relaxed) << "}";
+		threads << ",\"phases\":";
+		writePhases(threads, values);
+		threads << "}";
+	}
+	threads << "]";
+
+	ostringstream out;
+	out << "{\"elapsed_ms\":" << (now - startTime) / 1000000
+		<< ",\"progress\":{\"file\":\"" << escapeJson(lastFileName) << "\",\"bytes_done\":" << lastBytesDone
+		<< ",\"bytes_total\":" << lastBytesTotal << "},\"phases\":";
+	writePhases(out, total);
+	out << ",\"threads\":" << threads.str() << "}";
+
+	if (metricsFileName.empty())
+	{
+		cerr << out.str() << endl;
+		return;
+	}
+
+	ofstream metricsFile(metricsFileName, ios::app);
+	if (!metricsFile)
+	{
+		cerr << "Failed to open metrics file for writing: " << metricsFileName << endl;
+		return;
+	}
+	metricsFile << out.str() << endl;
+}
+
+void writeMetrics()
+{
+	lock_guard<mutex> lock(statsMutex);
+	writeMetricsLocked();
+	lastWrite = nowNanoseconds();
+}
+
+void reportProgress(const string& fileName, uint64_t bytesDone, uint64_t bytesTotal)
+{
+	ProgressCallback callback;
+	{
+		lock_guard<mutex> lock(statsMutex);
+		lastFileName = fileName;
+		lastBytesDone = bytesDone;
+		lastBytesTotal = bytesTotal;
+		callback = progressCallback;
+
+		uint64_t now = nowNanoseconds();
+		if (metricsInterval > 0 && now - lastWrite >= static_cast<uint64_t>(metricsInterval) * 1000000)
+		{
+			writeMetricsLocked();
+			lastWrite = now;
+		}
+	}
+
+	if (callback)
+		callback(fileName, bytesDone, bytesTotal);
+}
+
+void metricsTick(uint64_t bytesDone)
+{
+	threadStats().currentBytes.store(bytesDone, memory_order_relaxed);
+
+	lock_guard<mutex> lock(statsMutex);
+	uint64_t now = nowNanoseconds();
+	if (metricsInterval > 0 && now - lastWrite >= static_cast<uint64_t>(metricsInterval) * 1000000)
+	{
+		writeMetricsLocked();
+		lastWrite = now;
+	}
+}
@@ -0,0 +1,85 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <cstdint>
+#include <string>
+#include <functional>
+
+// Build with -DKRIT_METRICS to turn instrumentation on.
+// Without it every METRICS_* macro expands to nothing.
+
+enum MetricsPhase
+{
+    PHASE_COUNT_FREQUENCY = 0,
+    PHASE_BUILD_TREE,
+    PHASE_COMPRESS,
+    PHASE_DECOMPRESS,
+    PHASE_COPY,
+    PHASE_TOTAL
+};
+
+// fileName - file being processed, bytesDone/bytesTotal - over the whole archive
+typedef std::function<void(const std::string& fileName, uint64_t bytesDone, uint64_t bytesTotal)> ProgressCallback;
+
+void setProgressCallback(ProgressCallback callback);
+
+void reportProgress(const std::string& fileName, uint64_t bytesDone, uint64_t bytesTotal);
+
+void metricsAddTime(MetricsPhase phase, uint64_t nanoseconds);
+
+void metricsAddBytes(MetricsPhase phase, uint64_t bytesIn, uint64_t bytesOut);
+
+// empty name - write to stderr
+void setMetricsOutput(const std::string& outputFileName);
+
+// 0 - no periodic output, only the final writeMetrics() call
+void setMetricsInterval(uint32_t milliseconds);
+
+void writeMetrics();
+
+// zeroes all counters and restarts elapsed time, called at the start of every run
+void resetMetrics();
+
+// true - no JSON output at all (the self check runs hundreds of small archives)
+void setMetricsQuiet(bool quiet);
+
+// called from byte loops every METRICS_TICK_BYTES: publishes how far the running phase got
+// and writes periodic metrics if the interval has passed
+void metricsTick(uint64_t bytesDone);
+
+#define METRICS_TICK_BYTES (1 << 20)
+
+// also marks its phase as the one running on this thread until it goes out of scope
+struct PhaseTimer
+{
+    MetricsPhase phase;
+    uint64_t start;
+    int previousPhase;
+    uint64_t previousStart;
+    uint64_t previousBytes;
+
+    PhaseTimer(MetricsPhase p);
+    ~PhaseTimer();
+};
+
+#ifdef KRIT_METRICS
+#define METRICS_CONCAT_(a, b) a##b
+#define METRICS_CONCAT(a, b) METRICS_CONCAT_(a, b)
+#define METRICS_TIMER(phase) PhaseTimer METRICS_CONCAT(phaseTimer, __LINE__)(phase)
+#define METRICS_BYTES(phase, bytesIn, bytesOut) metricsAddBytes(phase, bytesIn, bytesOut)
+#define METRICS_PROGRESS(fileName, bytesDone, bytesTotal) reportProgress(fileName, bytesDone, bytesTotal)
+#define METRICS_WRITE() writeMetrics()
+#define METRICS_RESET() resetMetrics()
+#define METRICS_QUIET(quiet) setMetricsQuiet(quiet)
+#define METRICS_TICK(bytesDone) do { if (((bytesDone) & (METRICS_TICK_BYTES - 1)) == 0) metricsTick(bytesDone); } while (0)
+#else
+#define METRICS_TIMER(phase) ((void)0)
+#define METRICS_BYTES(phase, bytesIn, bytesOut) ((void)0)
+#define METRICS_PROGRESS(fileName, bytesDone, bytesTotal) ((void)0)
+#define METRICS_WRITE() ((void)0)
+#define METRICS_RESET() ((void)0)
+#define METRICS_QUIET(quiet) ((void)0)
+#define METRICS_TICK(bytesDone) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,111 @@
+#include <iostream>
+#include <cstring>
+#include <new>
+#include <algorithm>
+#ifdef _WIN32
+#include <io.h>
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include "writer.h"
+
+using namespace std;
+
+OutputWriter::OutputWriter() : file(nullptr), used(0), written(0), reserved(0), failed(false)
+{
+	buffer = static_cast<char*>(operator new[](WRITER_BUFFER_SIZE, align_val_t(WRITER_BUFFER_ALIGNMENT)));
+}
+
+OutputWriter::~OutputWriter()
+{
+	close();
+	operator delete[](buffer, align_val_t(WRITER_BUFFER_ALIGNMENT));
+}
+
+// reserve space so the file system can lay the file out in one piece
+static void reserveFileSize(FILE* file, uint64_t size)
+{
+	if (size == 0) return;
+#ifdef _WIN32
+	// only the allocation is set, the end of file stays where it is, so nothing gets written twice
+	FILE_ALLOCATION_INFO allocation;
+	allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+	HANDLE handle = reinterpret_cast<HANDLE>(_get_osfhandle(_fileno(file)));
+	if (handle != INVALID_HANDLE_VALUE)
+		SetFileInformationByHandle(handle, FileAllocationInfo, &allocation, sizeof(allocation));
+#else
+	posix_fallocate(fileno(file), 0, static_cast<off_t>(size));
+#endif
+}
+
+static void truncateFile(FILE* file, uint64_t size)
+{
+#ifdef _WIN32
+	// the end of file already is what was written, the unused allocation is released on close
+	(void)file;
+	(void)size;
+#else
+	if (ftruncate(fileno(file), static_cast<off_t>(size)) != 0)
+		cerr << "Failed to truncate unpacked file." << endl;
+#endif
+}
+
+bool OutputWriter::open(const string& fileName, uint64_t expectedSize)
+{
+	close();
+
+	file = fopen(fileName.c_str(), "wb");
+	if (!file)
+		return false;
+
+	setvbuf(file, nullptr, _IONBF, 0); // we buffer ourselves
+	reserveFileSize(file, expectedSize);
+	used = 0;
+	written = 0;
+	reserved = expectedSize;
+	failed = false;
+	return true;
+}
+
+void OutputWriter::flush()
+{
+	if (used == 0) return;
+
+	if (fwrite(buffer, 1, used, file) != used)
+		failed = true;
+
+	written += used;
+	used = 0;
+}
+
+void OutputWriter::write(const char* data, size_t length)
+{
+	while (length > 0)
+	{
+		size_t part = min(length, static_cast<size_t>(WRITER_BUFFER_SIZE) - used);
+		memcpy(buffer + used, data, part);
+		used += part;
+		data += part;
+		length -= part;
+		if (used == WRITER_BUFFER_SIZE)
+			flush();
+	}
+}
+
+bool OutputWriter::close()
+{
+	if (!file) return !failed;
+
+	flush();
+	if (written < reserved) // damaged archive, drop the unused reservation
+		truncateFile(file, written);
+
+	if (fclose(file) != 0)
+		failed = true;
+
+	file = nullptr;
+	return !failed;
+}
@@ -0,0 +1,46 @@
+#ifndef WRITER_H
+#define WRITER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#define WRITER_BUFFER_SIZE (1 << 20)
+#define WRITER_BUFFER_ALIGNMENT 4096
+
+// Output file for extraction: created once, its full size reserved up front,
+// bytes collected in a large aligned buffer and written in big chunks.
+class OutputWriter
+{
+public:
+    OutputWriter();
+    ~OutputWriter();
+
+    bool open(const std::string& fileName, uint64_t expectedSize);
+
+    void put(uint8_t byte)
+    {
+        buffer[used++] = static_cast<char>(byte);
+        if (used == WRITER_BUFFER_SIZE)
+            flush();
+    }
+
+    void write(const char* data, size_t length);
+
+    bool close();
+
+private:
+    FILE* file;
+    char* buffer;
+    size_t used;
+    uint64_t written;
+    uint64_t reserved;
+    bool failed;
+
+    void flush();
+
+    OutputWriter(const OutputWriter&) = delete;
+    OutputWriter& operator=(const OutputWriter&) = delete;
+};
+
+#endif